@@ -25,10 +25,12 @@
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
 #include <QDateTime>
+#include <QElapsedTimer>
 
 #include <PluginCbInterface.h>
 
 #include <KCalendarCore/ICalFormat>
+#include <KCalendarCore/MemoryCalendar>
 
 Q_LOGGING_CATEGORY(lcWebCal, "buteo.plugin.webcal", QtWarningMsg)
 
@@ -45,9 +47,15 @@ WebCalClient::WebCalClient(const QString& aPluginName,
                            const Buteo::SyncProfile& aProfile,
                            Buteo::PluginCbInterface *aCbInterface)
     : ClientPlugin(aPluginName, aProfile, aCbInterface)
+    , mHeadProbe(false)
+    , mProbeUnreliable(false)
+    , mProbed(false)
+    , mProbeFailed(false)
     , mCalendar(nullptr)
     , mStorage(nullptr)
+    , mAccessManager(nullptr)
     , mReply(nullptr)
+    , mRunRecorded(false)
 {
 }
 
@@ -57,6 +65,27 @@ WebCalClient::~WebCalClient()
 }
 
 static const QByteArray ETAG_PROPERTY("etag");
+static const QByteArray LENGTH_PROPERTY("contentLength");
+static const QByteArray LAST_MODIFIED_PROPERTY("lastModified");
+// Set to "true" when the server was seen ignoring If-None-Match, so the
+// validators are checked with a HEAD request before downloading, or to
+// "unreliable" when the probe proved useless, so it is not tried again.
+static const QByteArray HEAD_PROBE_PROPERTY("headProbe");
+static const QByteArray HISTORY_PROPERTY("syncHistory");
+
+// Default guards against hostile feeds, can be overridden per profile.
+static const uint MAX_COMPONENTS = 20000;
+static const uint MAX_RECURRENCES = 20000;
+static const uint MAX_PROPERTY_SIZE = 1024 * 1024;
+static const uint MAX_DOWNLOAD_SIZE = 32 * 1024 * 1024;
+
+static uint limit(const Buteo::Profile *client, const QString &key, uint defaultValue)
+{
+    bool ok = false;
+    const uint value = client->key(key).toUInt(&ok);
+    return ok ? value : defaultValue;
+}
+
 bool WebCalClient::init()
 {
     emit syncProgressDetail(iProfile.name(), Sync::SYNC_PROGRESS_INITIALISING);
@@ -80,6 +109,11 @@ bool WebCalClient::init()
             notebook->syncProfile() == getProfileName()) {
             mNotebookUid = notebook->uid();
             mNotebookEtag = notebook->customProperty(ETAG_PROPERTY).toUtf8();
+            mNotebookLength = notebook->customProperty(LENGTH_PROPERTY).toUtf8();
+            mNotebookLastModified = notebook->customProperty(LAST_MODIFIED_PROPERTY).toUtf8();
+            mHeadProbe = notebook->customProperty(HEAD_PROBE_PROPERTY) == QStringLiteral("true");
+            mProbeUnreliable = notebook->customProperty(HEAD_PROBE_PROPERTY) == QStringLiteral("unreliable");
+            mHistory.load(notebook->customProperty(HISTORY_PROPERTY));
             break;
         }
     }
@@ -112,33 +146,82 @@ bool WebCalClient::uninit()
 }
 
 bool WebCalClient::startSync()
+{
+    mRun = WebCalHistory::Run();
+    mRunRecorded = false;
+    mProbed = false;
+    mProbeFailed = false;
+    mAccessManager = new QNetworkAccessManager(this);
+    if (mHeadProbe) {
+        sendProbe();
+    } else {
+        sendRequest();
+    }
+
+    return true;
+}
+
+QNetworkRequest WebCalClient::networkRequest() const
 {
     QNetworkRequest request(mClient->key("remoteCalendar"));
     request.setAttribute(QNetworkRequest::FollowRedirectsAttribute,
                          mClient->boolKey("allowRedirect"));
+    return request;
+}
+
+void WebCalClient::sendProbe()
+{
+    const QNetworkRequest probe(networkRequest());
+    qCDebug(lcWebCal) << "Probing" << probe.url() << mNotebookEtag
+                      << mNotebookLength << mNotebookLastModified;
+
+    mReply = mAccessManager->head(probe);
+    connect(mReply, &QNetworkReply::finished, [this] {
+            QNetworkReply *reply = mReply;
+            reply->deleteLater();
+            mReply = nullptr;
+            mRun.httpStatus = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+            if (reply->error() == QNetworkReply::OperationCanceledError) {
+                return;
+            } else if (reply->error() != QNetworkReply::NoError) {
+                // Some servers do not support HEAD, fall back to a plain GET.
+                qCWarning(lcWebCal) << "Probe failed, downloading instead:" << reply->error();
+                mProbeFailed = true;
+                sendRequest();
+            } else {
+                processProbe(reply->rawHeader("etag"),
+                             reply->rawHeader("content-length"),
+                             reply->rawHeader("last-modified"));
+            }
+        });
+}
+
+void WebCalClient::sendRequest()
+{
+    QNetworkRequest request(networkRequest());
     if (!mNotebookEtag.isEmpty()) {
         request.setRawHeader("If-None-Match", mNotebookEtag);
     }
     qCDebug(lcWebCal) << "Requesting" << request.url() << mNotebookEtag;
 
-    QNetworkAccessManager *accessManager = new QNetworkAccessManager(this);
-    mReply = accessManager->get(request);
+    mReply = mAccessManager->get(request);
     connect(mReply, &QNetworkReply::finished, [this] {
             emit syncProgressDetail(iProfile.name(), Sync::SYNC_PROGRESS_FINALISING);
             mReply->deleteLater();
+            mRun.httpStatus = mReply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
             if (mReply->error() != QNetworkReply::NoError
                 && mReply->error() != QNetworkReply::OperationCanceledError) {
                 qCWarning(lcWebCal) << mReply->readAll();
                 failed(Buteo::SyncResults::CONNECTION_ERROR,
                        QStringLiteral("Network issue: %1.").arg(mReply->error()));
             } else if (mReply->error() == QNetworkReply::NoError) {
-                processData(mReply->readAll(), mReply->rawHeader("etag"));
+                processData(mReply->readAll(), mReply->rawHeader("etag"),
+                            mReply->rawHeader("content-length"),
+                            mReply->rawHeader("last-modified"));
             }
             mReply = nullptr;
         });
     connect(mReply, &QIODevice::readyRead, this, &WebCalClient::dataReceived);
-    
-    return true;
 }
 
 void WebCalClient::abortSync(Sync::SyncStatus aStatus)
@@ -151,15 +234,16 @@ void WebCalClient::abortSync(Sync::SyncStatus aStatus)
     }
 }
 
-void WebCalClient::succeed(const QString &label, unsigned int added, unsigned int deleted)
+void WebCalClient::succeed(const QString &label, unsigned int added,
+                           unsigned int deleted, unsigned int modified)
 {
     mResults = Buteo::SyncResults(QDateTime::currentDateTime().toUTC(),
                                   Buteo::SyncResults::SYNC_RESULT_SUCCESS,
                                   Buteo::SyncResults::NO_ERROR);
-    if (added || deleted) {
+    if (added || deleted || modified) {
         mResults.addTargetResults
             (Buteo::TargetResults(label.isEmpty() ? mNotebookUid : label,
-                                  Buteo::ItemCounts(added, deleted, 0),
+                                  Buteo::ItemCounts(added, deleted, modified),
                                   Buteo::ItemCounts()));
     }
     emit success(iProfile.name(), QStringLiteral("Remote calendar updated successfully."));
@@ -169,6 +253,13 @@ void WebCalClient::failed(Buteo::SyncResults::MinorCode code, const QString &mes
 {
     mResults = Buteo::SyncResults(QDateTime::currentDateTime().toUTC(),
                                   Buteo::SyncResults::SYNC_RESULT_FAILED, code);
+    // Record the failure, unless this sync already ended successfully,
+    // like when aborted after completion.
+    mKCal::Notebook::Ptr notebook = mStorage && !mRunRecorded
+        ? mStorage->notebook(mNotebookUid) : mKCal::Notebook::Ptr();
+    if (notebook && !storeNotebook(notebook, code)) {
+        qCWarning(lcWebCal) << "Cannot store sync history.";
+    }
     emit error(iProfile.name(), message, code);
 }
 
@@ -177,6 +268,29 @@ Buteo::SyncResults WebCalClient::getSyncResults() const
     return mResults;
 }
 
+QList<WebCalHistory::Run> WebCalClient::syncHistory() const
+{
+    return mHistory.runs();
+}
+
+bool WebCalClient::storeNotebook(mKCal::Notebook::Ptr notebook, Buteo::SyncResults::MinorCode code)
+{
+    // The run is recorded only once, when the sync ends.
+    WebCalHistory history(mHistory);
+    if (!mRunRecorded) {
+        mRun.time = QDateTime::currentDateTimeUtc();
+        mRun.result = code;
+        history.append(mRun);
+        notebook->setCustomProperty(HISTORY_PROPERTY, history.toString());
+    }
+    if (!mStorage->updateNotebook(notebook)) {
+        return false;
+    }
+    mHistory = history;
+    mRunRecorded = true;
+    return true;
+}
+
 bool WebCalClient::cleanUp()
 {
     if (mNotebookUid.isEmpty()) {
@@ -198,9 +312,246 @@ void WebCalClient::connectivityStateChanged(Sync::ConnectivityType aType, bool a
 void WebCalClient::dataReceived()
 {
     emit syncProgressDetail(iProfile.name(), Sync::SYNC_PROGRESS_RECEIVING_ITEMS);
+
+    // Stop before buffering an oversized body in memory.
+    const uint maxSize = limit(mClient, QStringLiteral("maxDownloadSize"), MAX_DOWNLOAD_SIZE);
+    if (maxSize && mReply
+        && (mReply->bytesAvailable() > maxSize
+            || mReply->header(QNetworkRequest::ContentLengthHeader).toLongLong() > maxSize)) {
+        qCWarning(lcWebCal) << "Remote calendar exceeds" << maxSize << "bytes, aborting.";
+        QNetworkReply *reply = mReply;
+        mReply = nullptr;
+        reply->disconnect();
+        reply->abort();
+        reply->deleteLater();
+        failed(Buteo::SyncResults::DATABASE_FAILURE,
+               QStringLiteral("Remote calendar exceeds %1 bytes.").arg(maxSize));
+    }
+}
+
+// Estimated number of occurrences per day for each rule frequency.
+static double frequencyPerDay(const QByteArray &freq)
+{
+    if (freq == "SECONDLY") {
+        return 86400.;
+    } else if (freq == "MINUTELY") {
+        return 1440.;
+    } else if (freq == "HOURLY") {
+        return 24.;
+    } else if (freq == "DAILY") {
+        return 1.;
+    } else if (freq == "WEEKLY") {
+        return 1. / 7.;
+    } else if (freq == "MONTHLY") {
+        return 1. / 28.;
+    } else {
+        return 1. / 365.;
+    }
+}
+
+static QByteArray ruleValue(const QByteArray &rule, const QByteArray &part)
+{
+    int at = rule.indexOf(part + '=');
+    if (at < 0) {
+        return QByteArray();
+    }
+    at += part.size() + 1;
+    const int end = rule.indexOf(';', at);
+    return rule.mid(at, end < 0 ? -1 : end - at);
+}
+
+static QDate valueDate(const QByteArray &value)
+{
+    return QDate::fromString(QString::fromLatin1(value.left(8)), QStringLiteral("yyyyMMdd"));
+}
+
+// Upper estimate of the occurrences per day of a rule: its frequency
+// multiplied by the size of each BYxxx list, at most one per second.
+static double rulePerDay(const QByteArray &rule)
+{
+    static const char *const expansions[] = {
+        "BYSECOND", "BYMINUTE", "BYHOUR", "BYDAY", "BYMONTHDAY",
+        "BYYEARDAY", "BYWEEKNO", "BYMONTH"
+    };
+    double perDay = frequencyPerDay(ruleValue(rule, "FREQ"));
+    for (const char *part : expansions) {
+        const QByteArray list = ruleValue(rule, part);
+        if (!list.isEmpty()) {
+            perDay *= 1 + list.count(',');
+        }
+    }
+    const qint64 interval = qMax(Q_INT64_C(1), ruleValue(rule, "INTERVAL").toLongLong());
+    return qMin(86400., perDay / interval);
+}
+
+// Number of occurrences a rule can generate, or -1 when it is unbounded.
+static qint64 ruleOccurrences(const QByteArray &rule, const QDate &start)
+{
+    const QByteArray count = ruleValue(rule, "COUNT");
+    if (!count.isEmpty()) {
+        // Saturate absurdly long counts instead of overflowing.
+        return count.size() > 12 ? Q_INT64_C(999999999999) : count.toLongLong();
+    }
+    const QDate until = valueDate(ruleValue(rule, "UNTIL"));
+    if (!until.isValid() || !start.isValid()) {
+        return -1;
+    } else if (until < start) {
+        return 0;
+    }
+    return qint64((start.daysTo(until) + 1) * rulePerDay(rule));
+}
+
+// Scan the raw data before handing it to the parser, to reject feeds
+// that would stall the import or fill the storage. A null limit means
+// no limit.
+static QString checkLimits(const QByteArray &data, uint maxComponents,
+                           uint maxRecurrences, uint maxPropertySize)
+{
+    quint64 components = 0, recurrences = 0;
+    // Rules are only evaluated at the end of their component, since
+    // DTSTART may come after them. Nested components, like alarms or
+    // unknown X- ones, keep their own level so they cannot hide the
+    // rules of their parent.
+    struct Level {
+        QDate start;
+        QList<QByteArray> rules;
+    };
+    QList<Level> levels;
+    auto evaluate = [&] (const Level &level) -> QString {
+        for (const QByteArray &rule : level.rules) {
+            const qint64 occurrences = ruleOccurrences(rule, level.start);
+            if (occurrences >= 0) {
+                recurrences += occurrences;
+            } else if (maxRecurrences && rulePerDay(rule) > 24.) {
+                // Unbounded rules are only expanded on demand, but
+                // sub-hourly ones make each expansion expensive.
+                return QStringLiteral("Unbounded recurrence rule %1 repeats more than hourly.")
+                    .arg(QString::fromLatin1(rule));
+            }
+        }
+        if (maxRecurrences && recurrences > maxRecurrences) {
+            return QStringLiteral("More than %1 recurrences.").arg(maxRecurrences);
+        }
+        return QString();
+    };
+    auto scan = [&] (const QByteArray &logical) -> QString {
+        int end = 0;
+        while (end < logical.size() && logical.at(end) != ';' && logical.at(end) != ':') {
+            end += 1;
+        }
+        const QByteArray property = logical.left(end).toUpper();
+        const QByteArray value = logical.mid(logical.indexOf(':') + 1).toUpper();
+        if (property == "BEGIN") {
+            components += 1;
+            levels.append(Level());
+        } else if (property == "END" && !levels.isEmpty()) {
+            const Level level = levels.takeLast();
+            const QString excess = evaluate(level);
+            if (!excess.isEmpty()) {
+                return excess;
+            }
+        } else if (property == "DTSTART" && !levels.isEmpty()) {
+            levels.last().start = valueDate(value);
+        } else if (property == "RRULE" && !levels.isEmpty()) {
+            levels.last().rules.append(value);
+        } else if (property == "RDATE" || property == "EXDATE") {
+            recurrences += 1 + value.count(',');
+        }
+
+        if (maxComponents && components > maxComponents) {
+            return QStringLiteral("More than %1 components.").arg(maxComponents);
+        }
+        if (maxRecurrences && recurrences > maxRecurrences) {
+            return QStringLiteral("More than %1 recurrences.").arg(maxRecurrences);
+        }
+        return QString();
+    };
+
+    // Properties are unfolded before being scanned, so that
+    // a folded value cannot escape the limits.
+    QByteArray logical;
+    int from = 0;
+    while (from < data.size()) {
+        int to = data.indexOf('\n', from);
+        if (to < 0) {
+            to = data.size();
+        }
+        int length = to - from;
+        if (length > 0 && data.at(to - 1) == '\r') {
+            length -= 1;
+        }
+        const QByteArray line = QByteArray::fromRawData(data.constData() + from, length);
+        from = to + 1;
+
+        const bool folded = !line.isEmpty() && (line.at(0) == ' ' || line.at(0) == '\t');
+        const quint64 size = folded ? quint64(logical.size()) + line.size() - 1 : line.size();
+        if (maxPropertySize && size > maxPropertySize) {
+            return QStringLiteral("A property exceeds %1 bytes.").arg(maxPropertySize);
+        }
+        if (folded) {
+            logical.append(line.constData() + 1, line.size() - 1);
+        } else {
+            const QString excess = scan(logical);
+            if (!excess.isEmpty()) {
+                return excess;
+            }
+            logical = QByteArray(line.constData(), line.size());
+        }
+    }
+    QString excess = scan(logical);
+    // Unterminated components still count.
+    while (excess.isEmpty() && !levels.isEmpty()) {
+        excess = evaluate(levels.takeLast());
+    }
+    return excess;
+}
+
+bool WebCalClient::isUnchanged(const QByteArray &etag, const QByteArray &length,
+                               const QByteArray &lastModified) const
+{
+    if (!etag.isEmpty()) {
+        return etag == mNotebookEtag;
+    }
+    // Without etag, only compare the validators known on both sides,
+    // since servers often omit Content-Length on HEAD or chunked replies.
+    bool compared = false;
+    if (!lastModified.isEmpty() && !mNotebookLastModified.isEmpty()) {
+        if (lastModified != mNotebookLastModified) {
+            return false;
+        }
+        compared = true;
+    }
+    if (!length.isEmpty() && !mNotebookLength.isEmpty()) {
+        if (length != mNotebookLength) {
+            return false;
+        }
+        compared = true;
+    }
+    return compared;
+}
+
+void WebCalClient::processProbe(const QByteArray &etag, const QByteArray &length,
+                                const QByteArray &lastModified)
+{
+    qCDebug(lcWebCal) << "Got probe" << etag << length << lastModified;
+    if (!isUnchanged(etag, length, lastModified)) {
+        mProbed = true;
+        sendRequest();
+        return;
+    }
+
+    emit syncProgressDetail(iProfile.name(), Sync::SYNC_PROGRESS_FINALISING);
+    mKCal::Notebook::Ptr notebook = mStorage->notebook(mNotebookUid);
+    if (!notebook) {
+        failed(Buteo::SyncResults::DATABASE_FAILURE,
+               QStringLiteral("Cannot find notebook."));
+        return;
+    }
+    commitNotebook(notebook, 0, 0, 0);
 }
 
-void WebCalClient::processData(const QByteArray &icsData, const QByteArray &etag)
+void WebCalClient::processData(const QByteArray &icsData, const QByteArray &etag,
+                               const QByteArray &length, const QByteArray &lastModified)
 {
     mKCal::Notebook::Ptr notebook = mStorage->notebook(mNotebookUid);
     if (!notebook) {
@@ -209,60 +560,142 @@ void WebCalClient::processData(const QByteArray &icsData, const QByteArray &etag
         return;
     }
 
-    unsigned int added = 0, deleted = 0;
+    unsigned int added = 0, deleted = 0, modified = 0;
+    mRun.bytes = icsData.size();
     qCDebug(lcWebCal) << "Got etag" << etag << "was" << mNotebookEtag;
     if (etag.isEmpty() || etag != mNotebookEtag) {
-        // Start by deleting all previous data.
-        if (!mStorage->loadNotebookIncidences(mNotebookUid)) {
+        const QString excess = checkLimits(icsData,
+                                           limit(mClient, QStringLiteral("maxComponents"), MAX_COMPONENTS),
+                                           limit(mClient, QStringLiteral("maxRecurrences"), MAX_RECURRENCES),
+                                           limit(mClient, QStringLiteral("maxPropertySize"), MAX_PROPERTY_SIZE));
+        if (!excess.isEmpty()) {
+            qCWarning(lcWebCal) << "Rejecting incoming ICS data:" << excess;
             failed(Buteo::SyncResults::DATABASE_FAILURE,
-                   QStringLiteral("Cannot load existing incidences."));
+                   QStringLiteral("Incoming ICS data exceeds limits: %1").arg(excess));
             return;
         }
-        const KCalendarCore::Incidence::List oldIncidences = mCalendar->incidences();
-        deleted = oldIncidences.count();
-        qCDebug(lcWebCal) << "Deleting" << deleted << "previous incidences.";
-        for (const KCalendarCore::Incidence::Ptr &incidence : oldIncidences) {
-            mCalendar->deleteIncidence(incidence);
-        }
-        // Deletion happens after insertion in mkcal, so ensure
-        // that incidences with a UID in icsData are deleted before.
-        if (deleted && !mStorage->save(mKCal::ExtendedStorage::PurgeDeleted)) {
+        if (!mStorage->loadNotebookIncidences(mNotebookUid)) {
             failed(Buteo::SyncResults::DATABASE_FAILURE,
-                   QStringLiteral("Cannot delete previous data."));
+                   QStringLiteral("Cannot load existing incidences."));
             return;
         }
+        QElapsedTimer timer;
+        timer.start();
 
-        // Recreate all incidences from incoming ICS data.
-        mCalendar->addNotebook(mNotebookUid, true);
-        mCalendar->setDefaultNotebook(mNotebookUid);
+        // Parse incoming ICS data aside, to compare with existing incidences.
+        KCalendarCore::MemoryCalendar::Ptr remote(new KCalendarCore::MemoryCalendar(QTimeZone::utc()));
         KCalendarCore::ICalFormat iCalFormat;
         qCDebug(lcWebCal) << icsData;
-        if (!icsData.isEmpty() && !iCalFormat.fromRawString(mCalendar, icsData)) {
+        if (!icsData.isEmpty() && !iCalFormat.fromRawString(remote, icsData)) {
             failed(Buteo::SyncResults::DATABASE_FAILURE,
                    QStringLiteral("Cannot parse incoming ICS data."));
             return;
         }
-        added = mCalendar->incidences().count();
-        qCDebug(lcWebCal) << "Adding" << added << "new incidences.";
-        qCDebug(lcWebCal) << "From calendar" << mCalendar->nonKDECustomProperty("X-WR-CALNAME")
-                  << mCalendar->nonKDECustomProperty("X-WR-CALDESC");
-        if (added && !mStorage->save()) {
+        qCDebug(lcWebCal) << "From calendar" << remote->nonKDECustomProperty("X-WR-CALNAME")
+                  << remote->nonKDECustomProperty("X-WR-CALDESC");
+        mRun.parseTime = timer.restart();
+
+        // Only touch incidences that actually changed, so their alarms
+        // are the only ones dropped or registered again by mkcal.
+        bool purge = false;
+        for (const KCalendarCore::Incidence::Ptr &incidence : mCalendar->incidences()) {
+            const KCalendarCore::Incidence::Ptr update =
+                remote->incidence(incidence->uid(), incidence->recurrenceId());
+            if (update && update->type() != incidence->type()) {
+                mCalendar->deleteIncidence(incidence);
+                deleted += 1;
+                purge = true;
+            }
+        }
+        // Deletion happens after insertion in mkcal, so ensure that
+        // a UID present in icsData with another type is deleted before.
+        // This is done before any other change, so it only contains
+        // the alarm removals of these incidences.
+        if (purge && !mStorage->save(mKCal::ExtendedStorage::PurgeDeleted)) {
+            failed(Buteo::SyncResults::DATABASE_FAILURE,
+                   QStringLiteral("Cannot delete previous data."));
+            return;
+        }
+        for (const KCalendarCore::Incidence::Ptr &incidence : mCalendar->incidences()) {
+            const KCalendarCore::Incidence::Ptr update =
+                remote->incidence(incidence->uid(), incidence->recurrenceId());
+            if (!update) {
+                mCalendar->deleteIncidence(incidence);
+                deleted += 1;
+                continue;
+            }
+            // Creation date is set to now by the parser when missing.
+            update->setCreated(incidence->created());
+            if (*update != *incidence) {
+                static_cast<KCalendarCore::IncidenceBase &>(*incidence) = *update;
+                modified += 1;
+            }
+        }
+        KCalendarCore::Incidence::List additions;
+        for (const KCalendarCore::Incidence::Ptr &incidence : remote->incidences()) {
+            const KCalendarCore::Incidence::Ptr old =
+                mCalendar->incidence(incidence->uid(), incidence->recurrenceId());
+            if (!old) {
+                additions.append(KCalendarCore::Incidence::Ptr(incidence->clone()));
+            }
+        }
+        mCalendar->addNotebook(mNotebookUid, true);
+        mCalendar->setDefaultNotebook(mNotebookUid);
+        for (const KCalendarCore::Incidence::Ptr &incidence : additions) {
+            if (!mCalendar->addIncidence(incidence)) {
+                qCWarning(lcWebCal) << "Cannot add incidence" << incidence->uid();
+                continue;
+            }
+            added += 1;
+        }
+        qCDebug(lcWebCal) << "Adding" << added << "new incidences,"
+                          << "updating" << modified << "and deleting" << deleted;
+        // All other additions, updates and deletions are stored in one
+        // go, so their alarms are reconciled as a single batch.
+        if ((added || modified || deleted)
+            && !mStorage->save(mKCal::ExtendedStorage::PurgeDeleted)) {
             failed(Buteo::SyncResults::DATABASE_FAILURE,
                    QStringLiteral("Cannot store data."));
             return;
         }
+        mRun.commitTime = timer.elapsed();
 
         // Record the etag so we only update in future if necessary.
         notebook->setCustomProperty(ETAG_PROPERTY, etag);
         // Store calendar name, if auto-detect has been requested.
         if (mClient->key("label").isEmpty()) {
-            notebook->setName(mCalendar->nonKDECustomProperty("X-WR-CALNAME"));
+            notebook->setName(remote->nonKDECustomProperty("X-WR-CALNAME"));
         }
-        if (!mCalendar->nonKDECustomProperty("X-WR-CALDESC").isEmpty()
-            && mCalendar->nonKDECustomProperty("X-WR-CALDESC") != notebook->name()) {
-            notebook->setDescription(mCalendar->nonKDECustomProperty("X-WR-CALDESC"));
+        if (!remote->nonKDECustomProperty("X-WR-CALDESC").isEmpty()
+            && remote->nonKDECustomProperty("X-WR-CALDESC") != notebook->name()) {
+            notebook->setDescription(remote->nonKDECustomProperty("X-WR-CALDESC"));
         }
     }
+    if (!icsData.isEmpty()) {
+        // Keep the other validators, to be compared with a HEAD probe later.
+        notebook->setCustomProperty(LENGTH_PROPERTY, length);
+        notebook->setCustomProperty(LAST_MODIFIED_PROPERTY, lastModified);
+    }
+    if (mProbeFailed
+        || (mProbed && !icsData.isEmpty() && isUnchanged(etag, length, lastModified))) {
+        // The HEAD request is not supported, or it reported a change that
+        // the download does not confirm: stop probing for good.
+        qCDebug(lcWebCal) << "HEAD probe is not reliable, stopping it.";
+        notebook->setCustomProperty(HEAD_PROBE_PROPERTY, QStringLiteral("unreliable"));
+    } else if (!mHeadProbe && !mProbeUnreliable && !icsData.isEmpty()
+               && isUnchanged(etag, length, lastModified)) {
+        // The server sent the full content again with unchanged
+        // validators, it does not honour If-None-Match.
+        qCDebug(lcWebCal) << "Server ignores If-None-Match, switching to HEAD probe.";
+        notebook->setCustomProperty(HEAD_PROBE_PROPERTY, QStringLiteral("true"));
+    }
+    commitNotebook(notebook, added, deleted, modified);
+}
+
+void WebCalClient::commitNotebook(mKCal::Notebook::Ptr notebook,
+                                  unsigned int added, unsigned int deleted,
+                                  unsigned int modified)
+{
     // Ensure that settings for the notebook are consistent.
     if (!mClient->key("label").isEmpty()) {
         notebook->setName(mClient->key("label"));
@@ -273,12 +706,15 @@ void WebCalClient::processData(const QByteArray &icsData, const QByteArray &etag
     notebook->setIsReadOnly(true);
     notebook->setIsMaster(false);
     notebook->setSyncDate(QDateTime::currentDateTimeUtc());
-    if (!mStorage->updateNotebook(notebook)) {
+    mRun.added = added;
+    mRun.deleted = deleted;
+    mRun.modified = modified;
+    if (!storeNotebook(notebook, Buteo::SyncResults::NO_ERROR)) {
         failed(Buteo::SyncResults::DATABASE_FAILURE,
                QStringLiteral("Cannot update notebook."));
         return;
     }
 
-    succeed(notebook->name(), added, deleted);
+    succeed(notebook->name(), added, deleted, modified);
 }
 
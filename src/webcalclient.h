@@ -30,8 +30,11 @@
 
 #include <extendedstorage.h>
 
+#include "webcalhistory.h"
+
 #include <QObject>
 #include <QLoggingCategory>
+#include <QNetworkRequest>
 
 #if defined(BUTEOWEBCALPLUGIN_LIBRARY)
 #  define SHARED_EXPORT Q_DECL_EXPORT
@@ -39,6 +42,7 @@
 #  define SHARED_EXPORT Q_DECL_IMPORT
 #endif
 
+class QNetworkAccessManager;
 class QNetworkReply;
 
 class SHARED_EXPORT WebCalClient : public Buteo::ClientPlugin
@@ -58,6 +62,8 @@ public:
     virtual Buteo::SyncResults getSyncResults() const;
     virtual bool cleanUp();
 
+    QList<WebCalHistory::Run> syncHistory() const;
+
 public Q_SLOTS:
     virtual void connectivityStateChanged(Sync::ConnectivityType aType, bool aState);
 
@@ -65,19 +71,44 @@ private Q_SLOTS:
     void dataReceived();
 
 private:
-    void succeed(const QString &label, unsigned int added, unsigned int deleted);
+    QNetworkRequest networkRequest() const;
+    void sendProbe();
+    void sendRequest();
+    void succeed(const QString &label, unsigned int added,
+                 unsigned int deleted, unsigned int modified);
     void failed(Buteo::SyncResults::MinorCode code, const QString &message);
-    void processData(const QByteArray &icsData, const QByteArray &etag);
+    bool isUnchanged(const QByteArray &etag, const QByteArray &length,
+                     const QByteArray &lastModified) const;
+    void processProbe(const QByteArray &etag, const QByteArray &length,
+                      const QByteArray &lastModified);
+    void processData(const QByteArray &icsData, const QByteArray &etag,
+                     const QByteArray &length = QByteArray(),
+                     const QByteArray &lastModified = QByteArray());
+    void commitNotebook(mKCal::Notebook::Ptr notebook,
+                        unsigned int added, unsigned int deleted,
+                        unsigned int modified);
+    bool storeNotebook(mKCal::Notebook::Ptr notebook, Buteo::SyncResults::MinorCode code);
 
     const Buteo::Profile        *mClient;
     QString                      mNotebookUid;
     QByteArray                   mNotebookEtag;
+    QByteArray                   mNotebookLength;
+    QByteArray                   mNotebookLastModified;
+    bool                         mHeadProbe;
+    bool                         mProbeUnreliable;
+    bool                         mProbed;
+    bool                         mProbeFailed;
     mKCal::ExtendedCalendar::Ptr mCalendar;
     mKCal::ExtendedStorage::Ptr  mStorage;
 
+    QNetworkAccessManager       *mAccessManager;
     QNetworkReply               *mReply;
     Buteo::SyncResults           mResults;
 
+    WebCalHistory                mHistory;
+    WebCalHistory::Run           mRun;
+    bool                         mRunRecorded;
+
     friend class tst_WebCalClient;
 };
 
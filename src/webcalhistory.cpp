@@ -0,0 +1,81 @@
+/*
+ * This file is part of buteo-sync-plugin-webcal package
+ *
+ * Copyright (C) 2021 Jolla Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include "webcalhistory.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+void WebCalHistory::load(const QString &data)
+{
+    mRuns.clear();
+    const QJsonArray array = QJsonDocument::fromJson(data.toUtf8()).array();
+    for (const QJsonValue &value : array) {
+        const QJsonObject obj = value.toObject();
+        Run run;
+        run.time = QDateTime::fromMSecsSinceEpoch(qint64(obj.value("time").toDouble()), Qt::UTC);
+        run.httpStatus = obj.value("status").toInt();
+        run.result = obj.value("result").toInt();
+        run.bytes = qint64(obj.value("bytes").toDouble());
+        run.parseTime = qint64(obj.value("parse").toDouble());
+        run.commitTime = qint64(obj.value("commit").toDouble());
+        run.added = obj.value("added").toInt();
+        run.deleted = obj.value("deleted").toInt();
+        run.modified = obj.value("modified").toInt();
+        mRuns.append(run);
+    }
+    while (mRuns.count() > MaxRuns) {
+        mRuns.removeFirst();
+    }
+}
+
+QString WebCalHistory::toString() const
+{
+    QJsonArray array;
+    for (const Run &run : mRuns) {
+        QJsonObject obj;
+        obj.insert("time", double(run.time.toMSecsSinceEpoch()));
+        obj.insert("status", run.httpStatus);
+        obj.insert("result", run.result);
+        obj.insert("bytes", double(run.bytes));
+        obj.insert("parse", double(run.parseTime));
+        obj.insert("commit", double(run.commitTime));
+        obj.insert("added", int(run.added));
+        obj.insert("deleted", int(run.deleted));
+        obj.insert("modified", int(run.modified));
+        array.append(obj);
+    }
+    return QString::fromUtf8(QJsonDocument(array).toJson(QJsonDocument::Compact));
+}
+
+void WebCalHistory::append(const Run &run)
+{
+    mRuns.append(run);
+    if (mRuns.count() > MaxRuns) {
+        mRuns.removeFirst();
+    }
+}
+
+QList<WebCalHistory::Run> WebCalHistory::runs() const
+{
+    return mRuns;
+}
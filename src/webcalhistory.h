@@ -0,0 +1,61 @@
+/*
+ * This file is part of buteo-sync-plugin-webcal package
+ *
+ * Copyright (C) 2021 Jolla Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef WEBCALHISTORY_H
+#define WEBCALHISTORY_H
+
+#include <QDateTime>
+#include <QList>
+
+/*! \brief Bounded record of the last sync runs of a profile
+ *
+ * The history is serialised as a compact JSON array, oldest run
+ * first, stored in the "syncHistory" custom property of the notebook.
+ * Any mkcal client can read it from there.
+ */
+class WebCalHistory
+{
+public:
+    struct Run {
+        QDateTime time;
+        int httpStatus = 0;
+        int result = 0;
+        qint64 bytes = 0;
+        qint64 parseTime = 0;  // in ms
+        qint64 commitTime = 0; // in ms
+        unsigned int added = 0;
+        unsigned int deleted = 0;
+        unsigned int modified = 0;
+    };
+
+    void load(const QString &data);
+    QString toString() const;
+
+    void append(const Run &run);
+    QList<Run> runs() const;
+
+    static const int MaxRuns = 16;
+
+private:
+    QList<Run> mRuns;
+};
+
+#endif // WEBCALHISTORY_H
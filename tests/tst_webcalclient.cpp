@@ -44,9 +44,25 @@ private slots:
     void initReuse();
     void firstDownload();
     void downloadWithSameEtag();
+    void probeWithSameEtag();
+    void probeValidators_data();
+    void probeValidators();
+    void downloadAfterProbe();
+    void downloadAfterUnreliableProbe();
+    void downloadAfterFailedProbe();
     void downloadWithDifferentEtag();
     void downloadWithMetaDataUpdateOnly();
     void downloadWithoutEtag();
+    void downloadWithoutChange();
+    void downloadWithTypeChange();
+    void downloadWithAlarm();
+    void syncHistory();
+    void importLimitsPerProfile();
+    void importPathological_data();
+    void importPathological();
+    void importRandomised();
+    void importUnboundedWithoutLimit();
+    void downloadTooLarge();
 
 private:
     void validate();
@@ -199,6 +215,122 @@ void tst_WebCalClient::downloadWithSameEtag()
     QCOMPARE(res.targetResults().count(), 0);
 
     validate();
+
+    // Full content was sent again although etag is unchanged.
+    mKCal::Notebook::Ptr notebook = mClient->mStorage->notebook(mNotebookUid);
+    QVERIFY(notebook);
+    QCOMPARE(notebook->customProperty("headProbe"), QStringLiteral("true"));
+}
+
+void tst_WebCalClient::probeWithSameEtag()
+{
+    QVERIFY(mClient->init());
+    QVERIFY(mClient->mHeadProbe);
+    mClient->processProbe("\"etag\"", QByteArray(), QByteArray());
+
+    const Buteo::SyncResults res(mClient->getSyncResults());
+    QCOMPARE(res.majorCode(), Buteo::SyncResults::SYNC_RESULT_SUCCESS);
+    QCOMPARE(res.targetResults().count(), 0);
+
+    validate();
+}
+
+void tst_WebCalClient::probeValidators_data()
+{
+    QTest::addColumn<QByteArray>("etag");
+    QTest::addColumn<QByteArray>("length");
+    QTest::addColumn<QByteArray>("lastModified");
+    QTest::addColumn<bool>("unchanged");
+
+    const QByteArray date("Tue, 20 Aug 2019 14:40:29 GMT");
+    QTest::newRow("same etag") << QByteArray("\"etag\"") << QByteArray("42") << date << true;
+    QTest::newRow("same etag, other length") << QByteArray("\"etag\"") << QByteArray("43") << QByteArray() << true;
+    QTest::newRow("different etag") << QByteArray("\"etag2\"") << QByteArray("42") << date << false;
+    QTest::newRow("no validators") << QByteArray() << QByteArray() << QByteArray() << false;
+    QTest::newRow("same date") << QByteArray() << QByteArray() << date << true;
+    QTest::newRow("same date and length") << QByteArray() << QByteArray("42") << date << true;
+    QTest::newRow("different date") << QByteArray() << QByteArray("42")
+                                    << QByteArray("Wed, 21 Aug 2019 14:40:29 GMT") << false;
+    QTest::newRow("different length") << QByteArray() << QByteArray("43") << date << false;
+}
+
+void tst_WebCalClient::probeValidators()
+{
+    QFETCH(QByteArray, etag);
+    QFETCH(QByteArray, length);
+    QFETCH(QByteArray, lastModified);
+    QFETCH(bool, unchanged);
+
+    mClient->mNotebookEtag = "\"etag\"";
+    mClient->mNotebookLength = "42";
+    mClient->mNotebookLastModified = "Tue, 20 Aug 2019 14:40:29 GMT";
+    QCOMPARE(mClient->isUnchanged(etag, length, lastModified), unchanged);
+
+    // Without stored etag, the probed one cannot match.
+    mClient->mNotebookEtag.clear();
+    if (!etag.isEmpty()) {
+        QVERIFY(!mClient->isUnchanged(etag, length, lastModified));
+    }
+
+    // Without anything stored, nothing can be compared.
+    mClient->mNotebookLength.clear();
+    mClient->mNotebookLastModified.clear();
+    QVERIFY(!mClient->isUnchanged(etag, length, lastModified));
+}
+
+void tst_WebCalClient::downloadAfterProbe()
+{
+    QVERIFY(mClient->init());
+    QVERIFY(mClient->mHeadProbe);
+    // Probe reported a change, but the download is the same.
+    mClient->mProbed = true;
+    mClient->processData(icsDataFirst, "\"etag\"");
+
+    const Buteo::SyncResults res(mClient->getSyncResults());
+    QCOMPARE(res.majorCode(), Buteo::SyncResults::SYNC_RESULT_SUCCESS);
+    QCOMPARE(res.targetResults().count(), 0);
+
+    validate();
+
+    mKCal::Notebook::Ptr notebook = mClient->mStorage->notebook(mNotebookUid);
+    QVERIFY(notebook);
+    QCOMPARE(notebook->customProperty("headProbe"), QStringLiteral("unreliable"));
+}
+
+void tst_WebCalClient::downloadAfterUnreliableProbe()
+{
+    QVERIFY(mClient->init());
+    QVERIFY(!mClient->mHeadProbe);
+    QVERIFY(mClient->mProbeUnreliable);
+    // Full content again for the same etag, but probing is not re-armed.
+    mClient->processData(icsDataFirst, "\"etag\"");
+
+    QCOMPARE(mClient->getSyncResults().majorCode(), Buteo::SyncResults::SYNC_RESULT_SUCCESS);
+    mKCal::Notebook::Ptr notebook = mClient->mStorage->notebook(mNotebookUid);
+    QVERIFY(notebook);
+    QCOMPARE(notebook->customProperty("headProbe"), QStringLiteral("unreliable"));
+}
+
+void tst_WebCalClient::downloadAfterFailedProbe()
+{
+    QVERIFY(mClient->init());
+    mKCal::Notebook::Ptr notebook = mClient->mStorage->notebook(mNotebookUid);
+    QVERIFY(notebook);
+    notebook->setCustomProperty("headProbe", QStringLiteral("true"));
+    QVERIFY(mClient->mStorage->updateNotebook(notebook));
+
+    cleanup();
+    init();
+    QVERIFY(mClient->init());
+    QVERIFY(mClient->mHeadProbe);
+    // The HEAD request failed, the fallback download happened.
+    mClient->mProbeFailed = true;
+    mClient->processData(icsDataFirst, "\"etag\"");
+
+    QCOMPARE(mClient->getSyncResults().majorCode(), Buteo::SyncResults::SYNC_RESULT_SUCCESS);
+    notebook = mClient->mStorage->notebook(mNotebookUid);
+    QVERIFY(notebook);
+    QCOMPARE(notebook->customProperty("headProbe"), QStringLiteral("unreliable"));
 }
 
 static const QByteArray icsDataSecond(
@@ -264,9 +396,9 @@ void tst_WebCalClient::downloadWithDifferentEtag()
     QCOMPARE(res.majorCode(), Buteo::SyncResults::SYNC_RESULT_SUCCESS);
     QCOMPARE(res.targetResults().count(), 1);
     Buteo::ItemCounts counts(res.targetResults().first().localItems());
-    QCOMPARE(counts.added, unsigned(2));
-    QCOMPARE(counts.deleted, unsigned(1));
-    QCOMPARE(counts.modified, unsigned(0));
+    QCOMPARE(counts.added, unsigned(1));
+    QCOMPARE(counts.deleted, unsigned(0));
+    QCOMPARE(counts.modified, unsigned(1));
 
     validateSecond();
 }
@@ -345,12 +477,388 @@ void tst_WebCalClient::downloadWithoutEtag()
     QCOMPARE(res.majorCode(), Buteo::SyncResults::SYNC_RESULT_SUCCESS);
     QCOMPARE(res.targetResults().count(), 1);
     Buteo::ItemCounts counts(res.targetResults().first().localItems());
+    QCOMPARE(counts.added, unsigned(0));
+    QCOMPARE(counts.deleted, unsigned(1));
+    QCOMPARE(counts.modified, unsigned(1));
+
+    validateThird();
+}
+
+void tst_WebCalClient::downloadWithoutChange()
+{
+    QVERIFY(mClient->init());
+    mClient->processData(icsDataThird, "");
+
+    const Buteo::SyncResults res(mClient->getSyncResults());
+    QCOMPARE(res.majorCode(), Buteo::SyncResults::SYNC_RESULT_SUCCESS);
+    QCOMPARE(res.targetResults().count(), 0);
+
+    validateThird();
+}
+
+static const QByteArray icsDataTodo(
+"BEGIN:VCALENDAR\n"
+"METHOD:PUBLISH\n"
+"PRODID:-//education.gouv.fr//NONSGML iCalcreator 2.6//\n"
+"VERSION:2.0\n"
+"X-WR-CALNAME:Calendrier Scolaire - Zone C\n"
+"X-WR-CALDESC:education.gouv.fr\n"
+"BEGIN:VTODO\n"
+"UID:609@education.gouv.fr\n"
+"DTSTAMP:20190820T144029Z\n"
+"SUMMARY:Préparer la rentrée scolaire\n"
+"DUE;VALUE=DATE:20190830\n"
+"END:VTODO\n"
+"END:VCALENDAR\n");
+void tst_WebCalClient::downloadWithTypeChange()
+{
+    QVERIFY(mClient->init());
+    mClient->processData(icsDataTodo, "");
+
+    Buteo::SyncResults res(mClient->getSyncResults());
+    QCOMPARE(res.majorCode(), Buteo::SyncResults::SYNC_RESULT_SUCCESS);
+    QCOMPARE(res.targetResults().count(), 1);
+    Buteo::ItemCounts counts(res.targetResults().first().localItems());
     QCOMPARE(counts.added, unsigned(1));
-    QCOMPARE(counts.deleted, unsigned(2));
+    QCOMPARE(counts.deleted, unsigned(1));
+    QCOMPARE(counts.modified, unsigned(0));
+
+    {
+        mKCal::ExtendedCalendar::Ptr cal(new mKCal::ExtendedCalendar(QTimeZone::utc()));
+        mKCal::ExtendedStorage::Ptr store = mKCal::ExtendedCalendar::defaultStorage(cal);
+        QVERIFY(store && store->open());
+        QVERIFY(store->loadNotebookIncidences(mNotebookUid));
+        QCOMPARE(cal->incidences().count(), 1);
+        QVERIFY(cal->todo(QStringLiteral("609@education.gouv.fr")));
+        QVERIFY(!cal->event(QStringLiteral("609@education.gouv.fr")));
+    }
+
+    // And back to an event.
+    cleanup();
+    init();
+    QVERIFY(mClient->init());
+    mClient->processData(icsDataThird, "");
+
+    res = mClient->getSyncResults();
+    QCOMPARE(res.majorCode(), Buteo::SyncResults::SYNC_RESULT_SUCCESS);
+    QCOMPARE(res.targetResults().count(), 1);
+    counts = res.targetResults().first().localItems();
+    QCOMPARE(counts.added, unsigned(1));
+    QCOMPARE(counts.deleted, unsigned(1));
     QCOMPARE(counts.modified, unsigned(0));
 
     validateThird();
 }
 
+static const QByteArray icsDataAlarm(
+"BEGIN:VCALENDAR\n"
+"METHOD:PUBLISH\n"
+"PRODID:-//education.gouv.fr//NONSGML iCalcreator 2.6//\n"
+"VERSION:2.0\n"
+"X-WR-CALNAME:Calendrier Scolaire - Zone C\n"
+"X-WR-CALDESC:education.gouv.fr\n"
+"X-WR-TIMEZONE:Europe/Paris\n"
+"BEGIN:VEVENT\n"
+"UID:609@education.gouv.fr\n"
+"DTSTAMP:20190820T144029Z\n"
+"DESCRIPTION:Rentrée scolaire des élèves\n"
+"DTSTART;VALUE=DATE:20190830\n"
+"LOCATION:Besançon\\, Bordeaux\\, Clermont-Ferrand\\, Dijon\\, Grenoble\\, Limog\n"
+" es\\, Lyon\\, Poitiers\n"
+"SUMMARY:Rentrée scolaire des élèves - Zone C\n"
+"TRANSP:TRANSPARENT\n"
+"BEGIN:VALARM\n"
+"ACTION:DISPLAY\n"
+"DESCRIPTION:Rentrée scolaire\n"
+"TRIGGER:-PT15H\n"
+"END:VALARM\n"
+"END:VEVENT\n"
+"END:VCALENDAR\n");
+void tst_WebCalClient::downloadWithAlarm()
+{
+    QVERIFY(mClient->init());
+    mClient->processData(icsDataAlarm, "\"alarm\"");
+
+    Buteo::SyncResults res(mClient->getSyncResults());
+    QCOMPARE(res.majorCode(), Buteo::SyncResults::SYNC_RESULT_SUCCESS);
+    QCOMPARE(res.targetResults().count(), 1);
+    Buteo::ItemCounts counts(res.targetResults().first().localItems());
+    QCOMPARE(counts.added, unsigned(0));
+    QCOMPARE(counts.deleted, unsigned(0));
+    QCOMPARE(counts.modified, unsigned(1));
+
+    // Same content with another etag in a next sync,
+    // the alarmed event is kept as is.
+    cleanup();
+    init();
+    QVERIFY(mClient->init());
+    mClient->processData(icsDataAlarm, "\"alarm2\"");
+
+    res = mClient->getSyncResults();
+    QCOMPARE(res.majorCode(), Buteo::SyncResults::SYNC_RESULT_SUCCESS);
+    QCOMPARE(res.targetResults().count(), 0);
+
+    mKCal::ExtendedCalendar::Ptr cal(new mKCal::ExtendedCalendar(QTimeZone::utc()));
+    mKCal::ExtendedStorage::Ptr store = mKCal::ExtendedCalendar::defaultStorage(cal);
+    QVERIFY(store && store->open());
+    QVERIFY(store->loadNotebookIncidences(mNotebookUid));
+    KCalendarCore::Incidence::Ptr ev = cal->incidence(QStringLiteral("609@education.gouv.fr"));
+    QVERIFY(ev);
+    QCOMPARE(ev->alarms().count(), 1);
+    QCOMPARE(ev->alarms().first()->startOffset().asSeconds(), -15 * 3600);
+}
+
+void tst_WebCalClient::syncHistory()
+{
+    QVERIFY(mClient->init());
+    const QList<WebCalHistory::Run> runs = mClient->syncHistory();
+    QVERIFY(!runs.isEmpty());
+    QVERIFY(runs.count() <= WebCalHistory::MaxRuns);
+    QCOMPARE(runs.last().result, int(Buteo::SyncResults::NO_ERROR));
+    QCOMPARE(runs.last().bytes, qint64(icsDataAlarm.size()));
+    QCOMPARE(runs.last().added, unsigned(0));
+    QCOMPARE(runs.last().deleted, unsigned(0));
+    QCOMPARE(runs.last().modified, unsigned(0));
+
+    mClient->processData(icsDataSecond, "\"etag5\"");
+    QCOMPARE(mClient->getSyncResults().majorCode(), Buteo::SyncResults::SYNC_RESULT_SUCCESS);
+
+    mKCal::Notebook::Ptr notebook = mClient->mStorage->notebook(mNotebookUid);
+    QVERIFY(notebook);
+    WebCalHistory history;
+    history.load(notebook->customProperty("syncHistory"));
+    QCOMPARE(history.runs().count(), qMin(runs.count() + 1, int(WebCalHistory::MaxRuns)));
+    const WebCalHistory::Run run = history.runs().last();
+    QVERIFY(run.time.isValid());
+    QCOMPARE(run.bytes, qint64(icsDataSecond.size()));
+    QCOMPARE(run.added, unsigned(1));
+    QCOMPARE(run.deleted, unsigned(0));
+    QCOMPARE(run.modified, unsigned(1));
+    QCOMPARE(history.toString(), mClient->mHistory.toString());
+
+    // An abort after completion does not overwrite the successful run.
+    mClient->abortSync();
+    notebook = mClient->mStorage->notebook(mNotebookUid);
+    QVERIFY(notebook);
+    history.load(notebook->customProperty("syncHistory"));
+    QCOMPARE(history.runs().count(), qMin(runs.count() + 1, int(WebCalHistory::MaxRuns)));
+    QCOMPARE(history.runs().last().result, int(Buteo::SyncResults::NO_ERROR));
+}
+
+void tst_WebCalClient::importLimitsPerProfile()
+{
+    Buteo::Profile *client = mClient->profile().clientProfile();
+    QVERIFY(client);
+    client->setKey(QStringLiteral("maxComponents"), QStringLiteral("2"));
+
+    QVERIFY(mClient->init());
+    mClient->processData(icsDataSecond, "\"etag6\"");
+    QCOMPARE(mClient->getSyncResults().majorCode(), Buteo::SyncResults::SYNC_RESULT_FAILED);
+
+    client->setKey(QStringLiteral("maxComponents"), QStringLiteral("3"));
+    mClient->processData(icsDataSecond, "\"etag6\"");
+    QCOMPARE(mClient->getSyncResults().majorCode(), Buteo::SyncResults::SYNC_RESULT_SUCCESS);
+
+    client->setKey(QStringLiteral("maxComponents"), QStringLiteral("0"));
+    mClient->processData(icsDataThird, "\"etag7\"");
+    QCOMPARE(mClient->getSyncResults().majorCode(), Buteo::SyncResults::SYNC_RESULT_SUCCESS);
+}
+
+static QByteArray feed(const QByteArray &content)
+{
+    return QByteArray("BEGIN:VCALENDAR\r\n"
+                      "VERSION:2.0\r\n"
+                      "PRODID:-//stress//test//\r\n")
+        + content + QByteArray("END:VCALENDAR\r\n");
+}
+
+static QByteArray event(const QByteArray &uid, const QByteArray &properties)
+{
+    return QByteArray("BEGIN:VEVENT\r\n"
+                      "UID:") + uid + QByteArray("\r\n"
+                      "DTSTAMP:20190820T144029Z\r\n"
+                      "DTSTART:20190830T080000Z\r\n"
+                      "SUMMARY:Stress\r\n")
+        + properties + QByteArray("END:VEVENT\r\n");
+}
+
+void tst_WebCalClient::importPathological_data()
+{
+    QTest::addColumn<QByteArray>("data");
+    QTest::addColumn<bool>("accepted");
+
+    QTest::newRow("huge line")
+        << feed(event("huge-line", "DESCRIPTION:" + QByteArray(2 * 1024 * 1024, 'a') + "\r\n"))
+        << false;
+
+    QByteArray folded("DESCRIPTION:");
+    for (int i = 0; i < 100000; i++) {
+        folded += QByteArray(" aaaaaaaaaaaaaaaaaaaa\r\n");
+    }
+    QTest::newRow("deeply folded")
+        << feed(event("deeply-folded", folded.replace("DESCRIPTION: ", "DESCRIPTION:")))
+        << false;
+
+    QByteArray rdates;
+    for (int i = 0; i < 10000; i++) {
+        rdates += "RDATE:20200101T000000Z,20200102T000000Z,20200103T000000Z\r\n";
+    }
+    QTest::newRow("many RDATEs") << feed(event("many-rdates", rdates)) << false;
+
+    QTest::newRow("huge RRULE count")
+        << feed(event("huge-count", "RRULE:FREQ=SECONDLY;COUNT=100000000000000000000\r\n"))
+        << false;
+
+    QTest::newRow("folded RRULE COUNT")
+        << feed(event("folded-count", "RRULE:FREQ=SECONDLY;CO\r\n UNT=999999999\r\n"))
+        << false;
+
+    QTest::newRow("folded RRULE COUNT value")
+        << feed(event("folded-count-value", "RRULE:FREQ=SECONDLY;COUNT=\r\n 999999999\r\n"))
+        << false;
+
+    QTest::newRow("unbounded SECONDLY RRULE")
+        << feed(event("unbounded-secondly", "RRULE:FREQ=SECONDLY\r\n"))
+        << false;
+
+    QTest::newRow("unbounded MINUTELY RRULE")
+        << feed(event("unbounded-minutely", "RRULE:FREQ=MINUTELY;INTERVAL=5\r\n"))
+        << false;
+
+    QTest::newRow("far UNTIL RRULE")
+        << feed(event("far-until", "RRULE:FREQ=SECONDLY;UNTIL=21000101T000000Z\r\n"))
+        << false;
+
+    QTest::newRow("RRULE hidden by X- subcomponent")
+        << feed(event("hidden-rule", "RRULE:FREQ=SECONDLY;COUNT=999999999\r\n"
+                      "BEGIN:X-FOO\r\n"
+                      "X-BAR:bar\r\n"
+                      "END:X-FOO\r\n"))
+        << false;
+
+    QTest::newRow("far UNTIL RRULE expanded by BYxxx")
+        << feed(event("far-until-by", "RRULE:FREQ=YEARLY;UNTIL=21000101T000000Z"
+                      ";BYMONTH=1,2,3,4,5,6,7,8,9,10,11,12"
+                      ";BYMONTHDAY=1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16,17,18,19,20,21,22,23,24,25,26,27,28"
+                      ";BYHOUR=0,6,12,18;BYMINUTE=0,15,30,45\r\n"))
+        << false;
+
+    QTest::newRow("unbounded HOURLY RRULE expanded by BYxxx")
+        << feed(event("unbounded-hourly-by", "RRULE:FREQ=HOURLY;BYMINUTE=0,10,20,30,40,50"
+                      ";BYSECOND=0,10,20,30,40,50\r\n"))
+        << false;
+
+    QTest::newRow("near UNTIL RRULE")
+        << feed(event("near-until", "RRULE:FREQ=HOURLY;UNTIL=20190906T000000Z\r\n"))
+        << true;
+
+    QTest::newRow("unbounded DAILY RRULE")
+        << feed(event("unbounded-daily", "RRULE:FREQ=DAILY\r\n"))
+        << true;
+
+    QTest::newRow("huge ATTACH")
+        << feed(event("huge-attach", "ATTACH;ENCODING=BASE64;VALUE=BINARY:"
+                      + QByteArray(3 * 1024 * 1024 / 4, 'a').toBase64() + "\r\n"))
+        << false;
+
+    QByteArray events;
+    for (int i = 0; i < 30000; i++) {
+        events += event("event-" + QByteArray::number(i), QByteArray());
+    }
+    QTest::newRow("many components") << feed(events) << false;
+}
+
+void tst_WebCalClient::importPathological()
+{
+    QFETCH(QByteArray, data);
+    QFETCH(bool, accepted);
+
+    QVERIFY(mClient->init());
+    QElapsedTimer timer;
+    timer.start();
+    mClient->processData(data, QByteArray());
+
+    QCOMPARE(mClient->getSyncResults().majorCode(),
+             accepted ? Buteo::SyncResults::SYNC_RESULT_SUCCESS
+             : Buteo::SyncResults::SYNC_RESULT_FAILED);
+    // Whether accepted or not, a hostile feed must not stall the import.
+    QVERIFY2(timer.elapsed() < 10000, QByteArray::number(timer.elapsed()).constData());
+}
+
+void tst_WebCalClient::importUnboundedWithoutLimit()
+{
+    const QByteArray data(feed(event("every-quarter", "RRULE:FREQ=MINUTELY;INTERVAL=15\r\n")));
+
+    QVERIFY(mClient->init());
+    mClient->processData(data, QByteArray());
+    QCOMPARE(mClient->getSyncResults().majorCode(), Buteo::SyncResults::SYNC_RESULT_FAILED);
+
+    // No recurrence limit allows frequent unbounded rules.
+    Buteo::Profile *client = mClient->profile().clientProfile();
+    QVERIFY(client);
+    client->setKey(QStringLiteral("maxRecurrences"), QStringLiteral("0"));
+    mClient->processData(data, QByteArray());
+    QCOMPARE(mClient->getSyncResults().majorCode(), Buteo::SyncResults::SYNC_RESULT_SUCCESS);
+}
+
+void tst_WebCalClient::downloadTooLarge()
+{
+    QTemporaryFile file;
+    QVERIFY(file.open());
+    QVERIFY(file.write(feed(event("too-large", "DESCRIPTION:" + QByteArray(4096, 'a') + "\r\n"))) > 0);
+    file.close();
+
+    Buteo::Profile *client = mClient->profile().clientProfile();
+    QVERIFY(client);
+    client->setKey(QStringLiteral("remoteCalendar"), QUrl::fromLocalFile(file.fileName()).toString());
+    client->setKey(QStringLiteral("maxDownloadSize"), QStringLiteral("1024"));
+
+    QVERIFY(mClient->init());
+    mClient->mHeadProbe = false;
+    QVERIFY(mClient->startSync());
+    QTRY_COMPARE(mClient->getSyncResults().majorCode(), Buteo::SyncResults::SYNC_RESULT_FAILED);
+    QCOMPARE(mClient->getSyncResults().minorCode(), Buteo::SyncResults::DATABASE_FAILURE);
+    QVERIFY(!mClient->mReply);
+}
+
+void tst_WebCalClient::importRandomised()
+{
+    // Fixed seed, so failures can be reproduced.
+    qsrand(42);
+    const QByteArray sources[] = {icsDataFirst, icsDataSecond, icsDataThird};
+
+    QVERIFY(mClient->init());
+    for (int i = 0; i < 200; i++) {
+        QByteArray data(sources[qrand() % 3]);
+        const int mutations = 1 + qrand() % 8;
+        for (int j = 0; j < mutations; j++) {
+            const int at = qrand() % data.size();
+            switch (qrand() % 4) {
+            case 0:
+                data[at] = char(qrand() % 256);
+                break;
+            case 1:
+                data.insert(at, "\r\n ");
+                break;
+            case 2:
+                data.insert(at, data.mid(qrand() % data.size(), qrand() % 64));
+                break;
+            default:
+                data.truncate(at);
+                break;
+            }
+            if (data.isEmpty()) {
+                data = sources[0];
+            }
+        }
+        // Every input must lead to a result of its own.
+        mClient->mResults = Buteo::SyncResults();
+        mClient->processData(data, QByteArray());
+        const Buteo::SyncResults::MajorCode code = mClient->getSyncResults().majorCode();
+        QVERIFY(code == Buteo::SyncResults::SYNC_RESULT_SUCCESS
+                || code == Buteo::SyncResults::SYNC_RESULT_FAILED);
+    }
+}
+
 #include "tst_webcalclient.moc"
 QTEST_MAIN(tst_WebCalClient)